@@ -0,0 +1,2 @@
+@echo off
+g++ -std=c++17 -O2 bxf2cpp.cpp -o bxf2cpp.exe && .\bxf2cpp.exe builtin_lib.hpp %1
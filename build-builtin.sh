@@ -0,0 +1,3 @@
+#!/bin/sh
+# compiles the symbols listed in libs.txt (or $1) into builtin_lib.hpp, rebuild shdl afterwards
+g++ -std=c++17 -O2 bxf2cpp.cpp -o bxf2cpp && ./bxf2cpp builtin_lib.hpp $1
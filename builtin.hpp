@@ -0,0 +1,41 @@
+// symbols compiled into the binary. builtin_lib.hpp is generated by bxf2cpp from the
+// files in libs.txt, the nodes of every top level symbol are stored in pre-order.
+struct BuiltinNode {
+	BXFNode::Type type;
+	const char *s;
+	int val;
+	int children;
+};
+
+#if __has_include("builtin_lib.hpp")
+#include "builtin_lib.hpp"
+#else
+constexpr BuiltinNode builtin_nodes[1] = {};
+constexpr size_t builtin_node_cnt = 0;
+#endif
+
+BXFNode *make_builtin_node(size_t &ptr)
+{
+	const BuiltinNode &b = builtin_nodes[ptr++];
+	BXFNode *ans;
+	if (b.type == BXFNode::STR) {
+		ans = new BXFNode(string(b.s));
+	} else if (b.type == BXFNode::INT) {
+		ans = new BXFNode(b.val);
+	} else {
+		ans = new BXFNode;
+		ans->id = b.s;
+	}
+	for (int i = 0; i < b.children; i++)
+		ans->children.push_back(make_builtin_node(ptr));
+	return hash_cons(ans);
+}
+
+vector<BXFNode *> builtin_bxf_node_list()
+{
+	vector<BXFNode *> ans;
+	size_t ptr = 0;
+	while (ptr != builtin_node_cnt)
+		ans.push_back(make_builtin_node(ptr));
+	return ans;
+}
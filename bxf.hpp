@@ -81,8 +81,10 @@ struct BXFNode {
 	enum Type { LIST, INT, STR } type;
 	string id;
 	string str;
-	int val;
+	int val = 0;
 	vector<BXFNode *> children;
+	size_t hash = 0;
+	bool shared = 0; // owned by the hash-consing pool, never changed or deleted
 
 	BXFNode() { type = LIST; }
 	BXFNode(const string &s) {
@@ -132,6 +134,7 @@ struct BXFNode {
 		return ans;
 	}
 
+	// copy of the node that still points to the shared subtrees of the original
 	BXFNode *clone() const {
 		BXFNode *ans = new BXFNode;
 		ans->id = id;
@@ -139,21 +142,68 @@ struct BXFNode {
 		ans->val = val;
 		ans->type = type;
 		for (auto c : children)
-			ans->children.push_back(c->clone());
+			ans->children.push_back(c->shared? c: c->clone());
 		return ans;
 	}
 
+	// copy of the whole subtree that can be changed freely
+	BXFNode *clone_deep() const {
+		BXFNode *ans = new BXFNode;
+		ans->id = id;
+		ans->str = str;
+		ans->val = val;
+		ans->type = type;
+		for (auto c : children)
+			ans->children.push_back(c->clone_deep());
+		return ans;
+	}
+
+	// replaces shared children with the given ids by private copies, so they can be changed
+	void own_children(const vector<string> &ids) {
+		for (auto &c : children)
+			if (c->shared && c->type == LIST && is_in(c->id, ids))
+				c = c->clone_deep();
+	}
+
 	static void delete_tree(BXFNode *v) {
-		if (v->type != LIST) {
-			delete v;
+		if (v->shared)
 			return;
-		}
 		for (auto c : v->children)
 			delete_tree(c);
 		delete v;
 	}
 };
 
+// the .bsf files repeat the same fonts, shapes and ports over and over, each distinct
+// subtree is kept once. children are already unique, so they compare by address.
+BXFNode *hash_cons(BXFNode *v)
+{
+	struct Hash {
+		size_t operator()(const BXFNode *v) const { return v->hash; }
+	};
+	struct Eq {
+		bool operator()(const BXFNode *a, const BXFNode *b) const {
+			return a->type == b->type && a->val == b->val && a->id == b->id && a->str == b->str && a->children == b->children;
+		}
+	};
+	static unordered_set<BXFNode *, Hash, Eq> pool;
+
+	size_t h = std::hash<string>()(v->type == BXFNode::LIST? v->id: v->str) ^ v->type;
+	h = h * 1000003 ^ std::hash<int>()(v->val);
+	for (auto c : v->children)
+		h = h * 1000003 ^ c->hash;
+	v->hash = h;
+
+	auto it = pool.find(v);
+	if (it != pool.end()) {
+		delete v;
+		return *it;
+	}
+	v->shared = 1;
+	pool.insert(v);
+	return v;
+}
+
 BXFNode *read_bxf_node(const vector<BXFToken> &vec, size_t &ptr)
 {
 	auto unexpected = [](const BXFToken &token) {
@@ -171,14 +221,14 @@ BXFNode *read_bxf_node(const vector<BXFToken> &vec, size_t &ptr)
 		while (vec[ptr].type != BXFToken::PARAN || vec[ptr].lexeme != ")")
 			ans->children.push_back(read_bxf_node(vec, ptr));
 		ptr++;
-		return ans;
+		return hash_cons(ans);
 	}
 
 	if (vec[ptr].type == BXFToken::STR)
-		return new BXFNode(vec[ptr++].lexeme);
+		return hash_cons(new BXFNode(vec[ptr++].lexeme));
 
 	if (vec[ptr].type == BXFToken::NUM)
-		return new BXFNode(stoi(vec[ptr++].lexeme));
+		return hash_cons(new BXFNode(stoi(vec[ptr++].lexeme)));
 
 	unexpected(vec[ptr]);
 	return 0;
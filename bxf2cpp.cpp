@@ -0,0 +1,70 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+using namespace std;
+
+#include "common.hpp"
+#include "bxf.hpp"
+
+string c_str(const string &s)
+{
+	string ans = "\"";
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') {
+			ans += '\\';
+			ans += c;
+		} else if (c < 32 || c >= 127) {
+			char buf[8];
+			snprintf(buf, sizeof buf, "\\%03o", c);
+			ans += buf;
+		} else {
+			ans += c;
+		}
+	}
+	return ans + "\"";
+}
+
+void gen_node(const BXFNode *v, ostream &out, size_t &cnt)
+{
+	cnt++;
+	if (v->type == BXFNode::STR)
+		out << "\t{BXFNode::STR, " << c_str(v->str) << ", 0, 0},\n";
+	else if (v->type == BXFNode::INT)
+		out << "\t{BXFNode::INT, 0, " << v->val << ", 0},\n";
+	else
+		out << "\t{BXFNode::LIST, " << c_str(v->id) << ", 0, " << v->children.size() << "},\n";
+	for (auto c : v->children)
+		gen_node(c, out, cnt);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 2 && argc != 3) {
+		cerr << "usage: " << argv[0] << " <output> [<list>]\n";
+		return 2;
+	}
+	auto libs = read_list(argc == 3? argv[2]: "libs.txt");
+	Reader reader(libs);
+	auto nodes = read_bxf_node_list(bxf_tokenize(reader));
+
+	ofstream out(argv[1]);
+	if (!out.is_open()) {
+		cerr << "can't open " << argv[1] << '\n';
+		return 1;
+	}
+	out << "// generated by bxf2cpp, do not edit\n";
+	out << "constexpr BuiltinNode builtin_nodes[] = {\n";
+	size_t cnt = 0;
+	for (auto v : nodes)
+		if (v->id == "pin" || v->id == "symbol")
+			gen_node(v, out, cnt);
+	if (!cnt)
+		out << "\t{},\n";
+	out << "};\n";
+	out << "constexpr size_t builtin_node_cnt = " << cnt << ";\n";
+}
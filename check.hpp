@@ -0,0 +1,81 @@
+// quartus snaps everything it draws to this grid
+int constexpr sheet_grid = 8;
+
+// something placed on the sheet, net is empty for symbol bodies, annotation blocks
+// and the pin points of unconnected ports
+struct LayoutItem {
+	Box box;
+	string owner;
+	string net;
+};
+
+// every pair of touching boxes. the sweep runs over x with the open boxes kept by y1,
+// a box can only reach back as far as the tallest one so the window stays small
+vector<pair<size_t,size_t>> touching_pairs(const vector<LayoutItem> &items)
+{
+	vector<size_t> order(items.size());
+	int max_h = 0;
+	for (size_t i = 0; i < items.size(); i++) {
+		order[i] = i;
+		max_h = max(max_h, items[i].box.y2 - items[i].box.y1);
+	}
+	sort(order.begin(), order.end(), [&](size_t i, size_t j) { return items[i].box.x1 < items[j].box.x1; });
+
+	vector<pair<size_t,size_t>> ans;
+	multimap<int, size_t> active;
+	vector<multimap<int, size_t>::iterator> where(items.size());
+	priority_queue<pair<int,size_t>, vector<pair<int,size_t>>, greater<pair<int,size_t>>> ends;
+	for (size_t i : order) {
+		const Box &b = items[i].box;
+		while (!ends.empty() && ends.top().first < b.x1) {
+			active.erase(where[ends.top().second]);
+			ends.pop();
+		}
+		for (auto it = active.lower_bound(b.y1 - max_h); it != active.end() && it->first <= b.y2; ++it)
+			if (items[it->second].box.touches(b))
+				ans.push_back({it->second, i});
+		where[i] = active.emplace(b.y1, i);
+		ends.push({b.x2, i});
+	}
+	return ans;
+}
+
+string point_str(int x, int y)
+{
+	return "(" + to_string(x) + ", " + to_string(y) + ")";
+}
+
+// overlapping symbols and annotations, stubs running through a body or into a stub of
+// another net, and anything off the grid
+vector<string> check_layout(const vector<LayoutItem> &items)
+{
+	vector<string> ans;
+	// only where things are placed and where wires attach, the sizes come from the library
+	for (auto &it : items) {
+		auto &b = it.box;
+		bool off = b.x1 % sheet_grid || b.y1 % sheet_grid;
+		if (it.net.size())
+			off |= b.x2 % sheet_grid || b.y2 % sheet_grid;
+		if (off)
+			ans.push_back("off grid: " + (it.net.empty()? it.owner: it.net + " stub of " + it.owner)
+				+ " at " + point_str(b.x1, b.y1));
+	}
+	for (auto [i, j] : touching_pairs(items)) {
+		auto &u = items[i], &v = items[j];
+		bool us = !u.net.empty(), vs = !v.net.empty();
+		if (!us && !vs) {
+			if (u.box.overlaps(v.box))
+				ans.push_back("overlap: " + u.owner + " and " + v.owner
+					+ " at " + point_str(max(u.box.x1, v.box.x1), max(u.box.y1, v.box.y1)));
+		} else if (us != vs) {
+			auto &s = us? u: v, &b = us? v: u;
+			if (crosses_body(s.box, b.box))
+				ans.push_back("overlap: " + s.net + " stub of " + s.owner + " runs through " + b.owner
+					+ " at " + point_str(s.box.x1, s.box.y1));
+		} else if (u.net != v.net && shorts_wire(u.box, v.box)) {
+			ans.push_back("short: " + u.net + " stub of " + u.owner + " touches " + v.net + " stub of " + v.owner
+				+ " at " + point_str(max(u.box.x1, v.box.x1), max(u.box.y1, v.box.y1)));
+		}
+	}
+	return ans;
+}
@@ -4,12 +4,15 @@ struct Connector {
 	pii p1, p2;
 	string name;
 	bool bus;
+	bool driver = 0;
 
 	string str() const {
 		string s11 = std::to_string(p1.first), s12 = to_string(p1.second), s21 = to_string(p2.first), s22 = to_string(p2.second);
-		return "(connector\n\t(text \"" + name + "\" (rect "
-			+ s21 + " " + s22 + " " + s21 + " " + s22
-			+ ") (font \"Arial\"))\n\t(pt "
+		return "(connector\n"
+			+ (name.empty()? "": "\t(text \"" + name + "\" (rect "
+				+ s21 + " " + s22 + " " + s21 + " " + s22
+				+ ") (font \"Arial\"))\n")
+			+ "\t(pt "
 			+ s11 + " " + s12
 			+ ")\n\t(pt "
 			+ s21 + " " + s22
@@ -98,11 +101,156 @@ vector<Connector> gen_connectors(vector<BXFNode *> ports, Geo geo, const SHDLEnt
 		string name = *port->inst_name();
 		size_t i = ent.tent->port_search(name);
 		if (ent.port[i].size())
-			ans.push_back({p1, p2, ent.port[i], is_bus_name(*port->type_name())});
+			ans.push_back({p1, p2, string(ent.port[i]), is_bus_name(*port->type_name()), port->first_id("output") != 0});
 	}
 	return ans;
 }
 
+// pin points of the ports left unconnected, a wire running through one would join it
+vector<pii> free_ports(vector<BXFNode *> ports, Geo geo, const SHDLEntity &ent)
+{
+	vector<pii> ans;
+	for (auto port : ports) {
+		BXFNode *v = port->first_id("pt");
+		if (ent.port[ent.tent->port_search(*port->inst_name())].empty())
+			ans.push_back({v->children[0]->val + geo.posx(), v->children[1]->val + geo.posy()});
+	}
+	return ans;
+}
+
+int constexpr route_grid = 8;
+int constexpr route_detours = 24;
+int constexpr route_targets = 4;
+
+Box seg_box(pii a, pii b)
+{
+	return {min(a.first, b.first), min(a.second, b.second), max(a.first, b.first), max(a.second, b.second)};
+}
+
+bool path_blocked(const GridIndex &index, const vector<pii> &path, int net)
+{
+	for (size_t i = 1; i < path.size(); i++) {
+		if (path[i-1] == path[i])
+			continue;
+		Box s = seg_box(path[i-1], path[i]);
+		bool bad = 0;
+		index.query(s, [&](const Box &b, int tag) {
+			if (bad || tag == net)
+				return;
+			bad = tag == -1? crosses_body(s, b): shorts_wire(s, b);
+		});
+		if (bad)
+			return 1;
+	}
+	return 0;
+}
+
+vector<pii> nearest_joints(const vector<pii> &joints, pii p)
+{
+	auto dist = [&](pii a) { return abs(a.first - p.first) + abs(a.second - p.second); };
+	vector<pii> ans = joints;
+	size_t cnt = min(ans.size(), (size_t)route_targets);
+	partial_sort(ans.begin(), ans.begin() + cnt, ans.end(), [&](pii a, pii b) { return dist(a) < dist(b); });
+	ans.resize(cnt);
+	return ans;
+}
+
+vector<vector<pii>> route_candidates(pii a, pii b)
+{
+	vector<vector<pii>> ans;
+	if (a.first == b.first || a.second == b.second)
+		ans.push_back({a, b});
+	ans.push_back({a, {b.first, a.second}, b});
+	ans.push_back({a, {a.first, b.second}, b});
+	int mx = (a.first + b.first) / 2 / route_grid * route_grid;
+	int my = (a.second + b.second) / 2 / route_grid * route_grid;
+	for (int k = 0; k <= route_detours; k++) {
+		for (int sign : {1, -1}) {
+			if (!k && sign < 0)
+				continue;
+			int x = mx + sign * k * route_grid, y = my + sign * k * route_grid;
+			ans.push_back({a, {x, a.second}, {x, b.second}, b});
+			ans.push_back({a, {a.first, y}, {b.first, y}, b});
+		}
+	}
+	return ans;
+}
+
+// turns the labelled stubs into real orthogonal wires. every net with more than one
+// terminal is grown as a tree from its driver; terminals that can't be reached keep their label.
+// pins take part as terminals with p1 == p2 and are not emitted. unconnected ports block
+// wires of every net.
+vector<Connector> route_nets(vector<Connector> stubs, const vector<Box> &bodies, const vector<pii> &free)
+{
+	GridIndex index;
+	for (auto &b : bodies)
+		index.insert(b, -1);
+
+	map<string, int> net_id;
+	vector<vector<size_t>> nets;
+	for (size_t i = 0; i < stubs.size(); i++) {
+		auto it = net_id.emplace(stubs[i].name, nets.size()).first;
+		if (it->second == (int)nets.size())
+			nets.emplace_back();
+		nets[it->second].push_back(i);
+	}
+	for (int n = 0; n < (int)nets.size(); n++) {
+		auto &terms = nets[n];
+		auto root = find_if(terms.begin(), terms.end(), [&](size_t i) { return stubs[i].driver; });
+		if (root != terms.end())
+			iter_swap(terms.begin(), root);
+		for (size_t k = 0; k < terms.size(); k++)
+			index.insert(seg_box(stubs[terms[k]].p1, stubs[terms[k]].p2), n);
+	}
+	for (size_t i = 0; i < free.size(); i++)
+		index.insert(seg_box(free[i], free[i]), nets.size() + i);
+
+	auto dist = [](pii a, pii b) { return abs(a.first - b.first) + abs(a.second - b.second); };
+	vector<Connector> ans;
+	for (int n = 0; n < (int)nets.size(); n++) {
+		auto &terms = nets[n];
+		if (terms.size() < 2)
+			continue;
+		pii origin = stubs[terms[0]].p2;
+		sort(terms.begin() + 1, terms.end(), [&](size_t i, size_t j) {
+			return dist(stubs[i].p2, origin) < dist(stubs[j].p2, origin);
+		});
+
+		bool bus = 0;
+		for (auto i : terms)
+			bus |= stubs[i].bus;
+		vector<pii> joints = {origin};
+		for (size_t k = 1; k < terms.size(); k++) {
+			auto &stub = stubs[terms[k]];
+			bool done = 0;
+			for (auto t : nearest_joints(joints, stub.p2)) {
+				for (auto &path : route_candidates(stub.p2, t)) {
+					if (path_blocked(index, path, n))
+						continue;
+					for (size_t i = 1; i < path.size(); i++) {
+						if (path[i-1] == path[i])
+							continue;
+						index.insert(seg_box(path[i-1], path[i]), n);
+						ans.push_back({path[i-1], path[i], "", bus});
+						joints.push_back(path[i-1]);
+					}
+					done = 1;
+					break;
+				}
+				if (done)
+					break;
+			}
+			if (done)
+				stub.name = "";
+		}
+	}
+
+	for (auto &stub : stubs)
+		if (stub.p1 != stub.p2)
+			ans.push_back(stub);
+	return ans;
+}
+
 void set_params(vector<BXFNode *> params, const SHDLEntity &ent)
 {
 	for (auto param : params) {
@@ -164,18 +312,64 @@ string bxf_code_gen(BXFNode *v, int depth)
 	return ans;
 }
 
-string code_gen(const vector<SHDLEntity> &vec)
+struct CodeGenOptions {
+	bool route = 0;
+	bool nudge = 0;
+};
+
+// column positions that keep each column clear of the one before it, counting the
+// side stubs and the annotation blocks that hang below a symbol
+vector<int> column_xs(const vector<SHDLEntity> &vec)
+{
+	vector<int> ans = {start_x};
+	int left = 0, right = 0, prev_right = INT_MIN;
+	auto close = [&]() {
+		int x = ans.back();
+		if (prev_right != INT_MIN)
+			x = max(x, prev_right + spacing - left);
+		if (x % sheet_grid)
+			x += sheet_grid - x % sheet_grid;
+		ans.back() = x;
+		prev_right = x + right;
+		left = right = 0;
+	};
+	for (auto &ent : vec) {
+		if (ent.id == "-next_col") {
+			close();
+			ans.push_back(ans.back() + col_len);
+			continue;
+		}
+		auto geo = get_geo(ent.tent->node);
+		left = min(left, geo.ports & 1? -con_len_h: 0);
+		right = max(right, geo.width + (geo.ports & 2? con_len_h: 0));
+		for (auto p : ent.tent->node->list_id("annotation_block")) {
+			auto rect = p->first_id("rect");
+			right = max(right, rect->children[2]->val - rect->children[0]->val);
+		}
+	}
+	close();
+	return ans;
+}
+
+string code_gen(const vector<SHDLEntity> &vec, const CodeGenOptions &opt = {})
 {
 	string ans = header;
-	int x = start_x, y = start_y;
+	vector<int> xs = opt.nudge? column_xs(vec): vector<int>();
+	size_t col = 0;
+	int x = opt.nudge? xs[0]: start_x, y = start_y;
+	vector<Connector> stubs;
+	vector<Box> bodies;
+	vector<pii> free;
+	vector<LayoutItem> items;
 	for (auto &ent : vec) {
 		if (ent.id == "-next_col") {
-			x += col_len;
+			x = opt.nudge? xs[++col]: x + col_len;
 			y = start_y;
 			continue;
 		}
 
 		BXFNode *node = ent.tent->node->clone();
+		node->own_children({"rect", "text", "parameter", "annotation_block"});
 
 		auto geo = get_geo(node);
 		geo.x = x;
@@ -183,6 +377,8 @@ string code_gen(const vector<SHDLEntity> &vec)
 		y += geo.tot_height() + spacing;
 
 		set_pos(node->first_id("rect"), geo);
+		Box body = {geo.posx(), geo.posy(), geo.posx() + geo.width, geo.posy() + geo.height};
+		items.push_back({body, string(ent.id), ""});
 
 		{
 			int ax = geo.x;
@@ -191,6 +387,7 @@ string code_gen(const vector<SHDLEntity> &vec)
 				auto rect = p->first_id("rect");
 				rect->children[3]->val += rect->children[3]->val - rect->children[1]->val - 8;
 				set_pos(rect, ax, ay);
+				items.push_back({{rect->children[0]->val, rect->children[1]->val, rect->children[2]->val, rect->children[3]->val}, string(ent.id) + " annotation", ""});
 				ay += rect->children[3]->val - rect->children[1]->val;
 				y += rect->children[3]->val - rect->children[1]->val;
 			}
@@ -199,10 +396,27 @@ string code_gen(const vector<SHDLEntity> &vec)
 		}
 
 		auto cons = gen_connectors(node->list_id("port"), geo, ent);
+		for (auto &con : cons)
+			items.push_back({seg_box(con.p1, con.p2), string(ent.id), con.name});
+		auto fp = free_ports(node->list_id("port"), geo, ent);
+		for (auto p : fp)
+			items.push_back({seg_box(p, p), string(ent.id) + " port", ""});
+
+		if (opt.route) {
+			bodies.push_back(body);
+			free.insert(free.end(), fp.begin(), fp.end());
+			BXFNode *pt = node->id == "pin"? node->first_id("pt"): 0;
+			if (pt) {
+				pii p = {pt->children[0]->val + geo.posx(), pt->children[1]->val + geo.posy()};
+				stubs.push_back({p, p, string(ent.id), is_bus_name(string(ent.id)), node->children[0]->id == "input"});
+			}
+			stubs.insert(stubs.end(), cons.begin(), cons.end());
+			cons.clear();
+		}
 
 		set_params(node->list_id("parameter"), ent);
 
-		set_name(node, ent.id);
+		set_name(node, string(ent.id));
 
 		ans += bxf_code_gen(node, 0);
 
@@ -211,5 +425,13 @@ string code_gen(const vector<SHDLEntity> &vec)
 		for (auto &con : cons)
 			ans += con.str();
 	}
+	if (opt.route)
+		for (auto &con : route_nets(stubs, bodies, free))
+			ans += con.str();
+
+	string warnings;
+	for (auto &w : check_layout(items))
+		warnings += "warning: " + w + '\n';
+	cerr << warnings;
 	return ans;
 }
@@ -2,6 +2,8 @@ class Reader {
 private:
 	vector<string> file_list;
 	FILE *f;
+	const string *text;
+	size_t text_pos;
 	int holder, last;
 	int col_no, line_no;
 	string file_name;
@@ -37,6 +39,13 @@ private:
 			holder = -2;
 			return last;
 		}
+		if (text) {
+			if (text_pos > text->size())
+				return last = -1;
+			last = text_pos == text->size()? '\n': (unsigned char)(*text)[text_pos];
+			text_pos++;
+			return last;
+		}
 		if (!f)
 			open_next();
 		if (!f)
@@ -66,12 +75,22 @@ public:
 		reverse(file_list.begin(), file_list.end());
 		holder = last = -2;
 		f = 0;
+		text = 0;
 	}
 	Reader(FILE *f, const string &name) {
 		holder = last = -2;
 		line_no = col_no = 1;
 		file_name = name;
 		this->f = f;
+		text = 0;
+	}
+	Reader(const string &text, const string &name) {
+		holder = last = -2;
+		line_no = col_no = 1;
+		file_name = name;
+		f = 0;
+		this->text = &text;
+		text_pos = 0;
 	}
 	~Reader() {
 		if (f)
@@ -0,0 +1,254 @@
+// just enough json for the language server
+struct Json {
+	enum Type { NUL, BOOL, NUM, STR, ARR, OBJ };
+	Type type = NUL;
+	bool b = 0;
+	double num = 0;
+	string str;
+	vector<Json> arr;
+	vector<pair<string, Json>> obj;
+
+	Json() {}
+	Json(bool b) : type(BOOL), b(b) {}
+	Json(int n) : type(NUM), num(n) {}
+	Json(double n) : type(NUM), num(n) {}
+	Json(const string &s) : type(STR), str(s) {}
+	Json(const char *s) : type(STR), str(s) {}
+
+	static Json array() {
+		Json ans;
+		ans.type = ARR;
+		return ans;
+	}
+	static Json object() {
+		Json ans;
+		ans.type = OBJ;
+		return ans;
+	}
+
+	const Json &operator[](const string &key) const {
+		static const Json null;
+		for (auto &[k, v] : obj)
+			if (k == key)
+				return v;
+		return null;
+	}
+	const Json &operator[](size_t i) const {
+		static const Json null;
+		return i < arr.size()? arr[i]: null;
+	}
+
+	Json &set(const string &key, Json v) {
+		obj.emplace_back(key, move(v));
+		return *this;
+	}
+	Json &push(Json v) {
+		arr.push_back(move(v));
+		return *this;
+	}
+
+	bool is_null() const { return type == NUL; }
+	int as_int() const { return type == NUM? (int)num: 0; }
+
+	void dump(string &out) const {
+		if (type == NUL) {
+			out += "null";
+		} else if (type == BOOL) {
+			out += b? "true": "false";
+		} else if (type == NUM) {
+			if (num == (long long)num)
+				out += to_string((long long)num);
+			else
+				out += to_string(num);
+		} else if (type == STR) {
+			dump_str(out, str);
+		} else if (type == ARR) {
+			out += '[';
+			for (size_t i = 0; i < arr.size(); i++) {
+				if (i)
+					out += ',';
+				arr[i].dump(out);
+			}
+			out += ']';
+		} else {
+			out += '{';
+			for (size_t i = 0; i < obj.size(); i++) {
+				if (i)
+					out += ',';
+				dump_str(out, obj[i].first);
+				out += ':';
+				obj[i].second.dump(out);
+			}
+			out += '}';
+		}
+	}
+	string dump() const {
+		string ans;
+		dump(ans);
+		return ans;
+	}
+
+	static void dump_str(string &out, const string &s) {
+		out += '"';
+		for (unsigned char c : s) {
+			if (c == '"' || c == '\\') {
+				out += '\\';
+				out += c;
+			} else if (c == '\n') {
+				out += "\\n";
+			} else if (c < 32) {
+				char buf[8];
+				snprintf(buf, sizeof buf, "\\u%04x", c);
+				out += buf;
+			} else {
+				out += c;
+			}
+		}
+		out += '"';
+	}
+};
+
+// returns null on malformed input
+Json json_parse(const string &s, size_t &p)
+{
+	auto ws = [&]() {
+		while (p < s.size() && isspace((unsigned char)s[p]))
+			p++;
+	};
+	auto utf8 = [](string &out, unsigned cp) {
+		if (cp < 0x80) {
+			out += (char)cp;
+		} else if (cp < 0x800) {
+			out += (char)(0xc0 | cp >> 6);
+			out += (char)(0x80 | (cp & 0x3f));
+		} else if (cp < 0x10000) {
+			out += (char)(0xe0 | cp >> 12);
+			out += (char)(0x80 | (cp >> 6 & 0x3f));
+			out += (char)(0x80 | (cp & 0x3f));
+		} else {
+			out += (char)(0xf0 | cp >> 18);
+			out += (char)(0x80 | (cp >> 12 & 0x3f));
+			out += (char)(0x80 | (cp >> 6 & 0x3f));
+			out += (char)(0x80 | (cp & 0x3f));
+		}
+	};
+	auto read_str = [&](string &out) {
+		p++;
+		while (p < s.size() && s[p] != '"') {
+			if (s[p] != '\\') {
+				out += s[p++];
+				continue;
+			}
+			if (++p == s.size())
+				return 0;
+			char e = s[p++];
+			if (e == 'n')
+				out += '\n';
+			else if (e == 't')
+				out += '\t';
+			else if (e == 'r')
+				out += '\r';
+			else if (e == 'b')
+				out += '\b';
+			else if (e == 'f')
+				out += '\f';
+			else if (e == 'u') {
+				if (p + 4 > s.size())
+					return 0;
+				unsigned cp = strtoul(s.substr(p, 4).c_str(), 0, 16);
+				p += 4;
+				if (0xd800 <= cp && cp < 0xdc00 && p + 6 <= s.size() && s[p] == '\\' && s[p+1] == 'u') {
+					unsigned lo = strtoul(s.substr(p + 2, 4).c_str(), 0, 16);
+					p += 6;
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+				}
+				utf8(out, cp);
+			} else {
+				out += e;
+			}
+		}
+		if (p == s.size())
+			return 0;
+		p++;
+		return 1;
+	};
+
+	ws();
+	if (p == s.size())
+		return {};
+	Json ans;
+	char c = s[p];
+	if (c == '{') {
+		ans = Json::object();
+		p++;
+		ws();
+		if (p < s.size() && s[p] == '}') {
+			p++;
+			return ans;
+		}
+		for (;;) {
+			ws();
+			string key;
+			if (p == s.size() || s[p] != '"' || !read_str(key))
+				return {};
+			ws();
+			if (p == s.size() || s[p++] != ':')
+				return {};
+			ans.set(key, json_parse(s, p));
+			ws();
+			if (p == s.size())
+				return {};
+			if (s[p++] == '}')
+				return ans;
+			if (s[p-1] != ',')
+				return {};
+		}
+	}
+	if (c == '[') {
+		ans = Json::array();
+		p++;
+		ws();
+		if (p < s.size() && s[p] == ']') {
+			p++;
+			return ans;
+		}
+		for (;;) {
+			ans.push(json_parse(s, p));
+			ws();
+			if (p == s.size())
+				return {};
+			if (s[p++] == ']')
+				return ans;
+			if (s[p-1] != ',')
+				return {};
+		}
+	}
+	if (c == '"') {
+		ans.type = Json::STR;
+		return read_str(ans.str)? ans: Json();
+	}
+	if (!s.compare(p, 4, "true")) {
+		p += 4;
+		return true;
+	}
+	if (!s.compare(p, 5, "false")) {
+		p += 5;
+		return false;
+	}
+	if (!s.compare(p, 4, "null")) {
+		p += 4;
+		return {};
+	}
+	char *end;
+	double num = strtod(s.c_str() + p, &end);
+	if (end == s.c_str() + p)
+		return {};
+	p = end - s.c_str();
+	return num;
+}
+
+Json json_parse(const string &s)
+{
+	size_t p = 0;
+	return json_parse(s, p);
+}
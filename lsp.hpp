@@ -0,0 +1,432 @@
+// language server on stdin/stdout. documents are cut into chunks of whole declarations,
+// an edit only re-lexes and re-parses the chunks around it. positions are taken as
+// byte offsets, which is what lsp counts for the ascii shdl is written in.
+
+struct SHDLChunk {
+	int start, end; // lines [start, end) of the document
+	vector<SHDLToken> tokens; // lines counted from start, 1 based like the reader
+	vector<SHDLDecl> decls;
+	vector<SHDLDiag> diags;
+	SHDLNames names; // dropped with the chunk when it is parsed again
+};
+
+struct SHDLDocument {
+	vector<string> lines;
+	vector<SHDLChunk> chunks;
+	const map<string, BXFTableEnt *> *table;
+
+	SHDLDocument(const map<string, BXFTableEnt *> *table) : table(table) {}
+
+	size_t chunk_at(int line) const {
+		auto it = upper_bound(chunks.begin(), chunks.end(), line, [](int l, const SHDLChunk &c) { return l < c.start; });
+		return it == chunks.begin()? 0: it - chunks.begin() - 1;
+	}
+
+	// re-lexes chunks [i, j], which cover lines [chunks[i].start, chunks[j].end), and
+	// grows the range while a comment or brace is still open at its end
+	void relex(size_t i, size_t j) {
+		int start = chunks[i].start;
+		vector<SHDLToken> tokens;
+		vector<SHDLDiag> diags;
+		vector<size_t> cuts;
+		for (size_t step = 1;; step *= 2) {
+			string text;
+			for (int l = start; l < chunks[j].end; l++) {
+				text += lines[l];
+				text += '\n';
+			}
+			text.pop_back();
+			Reader reader(text, "");
+			diags.clear();
+			tokens = shdl_tokenize(reader, &diags);
+
+			// braces don't nest, the parser reads a brace up to the first }. a chunk may only
+			// start where parsing on from there alone gives the same declarations: not at the
+			// name of a pin on the line after its keyword, and not at a pin while a symbol
+			// before it can still take port and param
+			cuts = {0};
+			bool brace = 0, symbol = 0, pin = 0;
+			for (size_t k = 0; k < tokens.size(); k++) {
+				const SHDLToken &t = tokens[k];
+				if (t.type == SHDLToken::NL)
+					continue;
+				if (!brace && !pin && (!k || shdl_decl_start(tokens, k))) {
+					if (k && !(symbol && t.is_pin()))
+						cuts.push_back(k);
+					if (t.type == SHDLToken::ID)
+						symbol = 1;
+					else if (t.kw == SHDLToken::NEXT_COL)
+						symbol = 0;
+				}
+				pin = t.is_pin();
+				if (t.is_punc('{'))
+					brace = 1;
+				if (t.is_punc('}'))
+					brace = 0;
+			}
+			if (j + 1 == chunks.size())
+				break;
+			// the same holds for the chunk after the range
+			const SHDLToken *next = 0;
+			for (auto &t : chunks[j+1].tokens) {
+				if (t.type != SHDLToken::NL) {
+					next = &t;
+					break;
+				}
+			}
+			bool joined = pin || (symbol && next && next->is_pin());
+			// the tokenizer only runs into the end inside a comment or string, which takes the rest
+			if (diags.size() && diags.back().msg == "unexpected eof")
+				j = chunks.size() - 1;
+			else if (brace || joined)
+				j = min(j + step, chunks.size() - 1);
+			else
+				break;
+		}
+		cuts.push_back(tokens.size());
+
+		vector<SHDLChunk> fresh;
+		for (size_t c = 0; c + 1 < cuts.size(); c++) {
+			SHDLChunk chunk;
+			int first = c? tokens[cuts[c]].line: 1;
+			chunk.start = start + first - 1;
+			chunk.end = c + 2 < cuts.size()? start + tokens[cuts[c+1]].line - 1: chunks[j].end;
+			for (size_t k = cuts[c]; k < cuts[c+1]; k++) {
+				chunk.tokens.push_back(move(tokens[k]));
+				chunk.tokens.back().line -= first - 1;
+			}
+			fresh.push_back(move(chunk));
+		}
+		for (auto &d : diags) {
+			size_t c = fresh.size() - 1;
+			while (c && start + d.line - 1 < fresh[c].start)
+				c--;
+			d.line -= fresh[c].start - start;
+			fresh[c].diags.push_back(d);
+		}
+		for (auto &chunk : fresh) {
+			chunk.decls = shdl_parse(chunk.tokens, chunk.names, &chunk.diags);
+			shdl_resolve(chunk.decls, *table, chunk.names, &chunk.diags);
+		}
+		chunks.erase(chunks.begin() + i, chunks.begin() + j + 1);
+		chunks.insert(chunks.begin() + i, make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+	}
+
+	void set_text(const string &text) {
+		lines.clear();
+		size_t p = 0, q;
+		while ((q = text.find('\n', p)) != string::npos) {
+			lines.push_back(text.substr(p, q - p));
+			p = q + 1;
+		}
+		lines.push_back(text.substr(p));
+		chunks.clear();
+		chunks.push_back({0, (int)lines.size()});
+		relex(0, 0);
+	}
+
+	void edit(int sl, int sc, int el, int ec, const string &text) {
+		sl = min(max(sl, 0), (int)lines.size() - 1);
+		el = min(max(el, sl), (int)lines.size() - 1);
+		size_t i = chunk_at(sl), j = chunk_at(el);
+		if (i)
+			i--; // the edit may join the first line to the declaration before it
+
+		string s = lines[sl].substr(0, min((size_t)max(sc, 0), lines[sl].size())) + text
+		           + lines[el].substr(min((size_t)max(ec, 0), lines[el].size()));
+		vector<string> fresh;
+		size_t p = 0, q;
+		while ((q = s.find('\n', p)) != string::npos) {
+			fresh.push_back(s.substr(p, q - p));
+			p = q + 1;
+		}
+		fresh.push_back(s.substr(p));
+		int delta = (int)fresh.size() - (el - sl + 1);
+		lines.erase(lines.begin() + sl, lines.begin() + el + 1);
+		lines.insert(lines.begin() + sl, make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+
+		chunks[j].end += delta;
+		for (size_t k = j + 1; k < chunks.size(); k++) {
+			chunks[k].start += delta;
+			chunks[k].end += delta;
+		}
+		relex(i, j);
+	}
+};
+
+// what is under or right before the cursor
+struct SHDLContext {
+	enum Kind { NONE, SYMBOL, PORT, PARAM, NET } kind;
+	const SHDLToken *decl; // symbol of the enclosing declaration
+	size_t tok; // index of the token under the cursor, or tokens.size()
+};
+
+SHDLContext shdl_context(const vector<SHDLToken> &tokens, int line, int col)
+{
+	const SHDLToken *decl = 0;
+	SHDLToken::Keyword brace = SHDLToken::NONE, pending = SHDLToken::NONE;
+	bool colon = 0, stmt = 1;
+	auto kind = [&](const SHDLToken *t) {
+		if (brace)
+			return colon? SHDLContext::NET: brace == SHDLToken::PORT? SHDLContext::PORT: SHDLContext::PARAM;
+		if (stmt && (!t || t->type == SHDLToken::ID || t->kw == SHDLToken::INPUT || t->kw == SHDLToken::OUTPUT
+		             || t->kw == SHDLToken::BIDIR))
+			return SHDLContext::SYMBOL;
+		return SHDLContext::NONE;
+	};
+	for (size_t k = 0; k < tokens.size(); k++) {
+		auto &t = tokens[k];
+		if (t.line > line || (t.line == line && t.col > col))
+			break;
+		if (t.type != SHDLToken::NL && t.line == line && col <= t.col + (int)t.lexeme.size()) {
+			auto ans = kind(&t);
+			return {ans, ans == SHDLContext::SYMBOL? &t: decl, k};
+		}
+		if (brace) {
+			if (t.is_punc('}')) {
+				brace = SHDLToken::NONE;
+				stmt = 0;
+			} else if (t.is_punc(':')) {
+				colon = 1;
+			} else if (t.is_punc(';') || t.type == SHDLToken::NL) {
+				colon = 0;
+			}
+		} else if (t.type == SHDLToken::NL) {
+			stmt = 1;
+		} else if (stmt && kind(&t) == SHDLContext::SYMBOL) {
+			decl = &t;
+			stmt = 0;
+		} else if (t.kw == SHDLToken::PORT || t.kw == SHDLToken::PARAM) {
+			pending = t.kw;
+		} else if (t.is_punc('{') && pending) {
+			brace = pending;
+			pending = SHDLToken::NONE;
+			colon = 0;
+		} else {
+			stmt = 0;
+		}
+	}
+	return {kind(0), decl, tokens.size()};
+}
+
+class LSPServer {
+private:
+	const map<string, BXFTableEnt *> &table;
+	map<string, SHDLDocument> docs;
+	bool shut = 0;
+
+	static bool read_message(Json &msg) {
+		string line;
+		size_t len = 0;
+		bool any = 0;
+		while (getline(cin, line)) {
+			if (line.size() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty()) {
+				if (any)
+					break;
+				continue;
+			}
+			any = 1;
+			if (!line.compare(0, 15, "Content-Length:"))
+				len = stoul(line.substr(15));
+		}
+		if (!cin)
+			return 0;
+		string body(len, 0);
+		cin.read(&body[0], len);
+		msg = json_parse(body);
+		return (bool)cin;
+	}
+
+	static void send(const Json &msg) {
+		string body = msg.dump();
+		cout << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+		cout.flush();
+	}
+
+	static void reply(const Json &id, Json result) {
+		send(Json::object().set("jsonrpc", "2.0").set("id", id).set("result", move(result)));
+	}
+
+	static Json pos(int line, int col) {
+		return Json::object().set("line", line).set("character", col);
+	}
+
+	const BXFTableEnt *symbol(const string &id) const {
+		auto it = table.find(id);
+		return it == table.end()? 0: it->second;
+	}
+
+	void publish(const string &uri) {
+		Json diags = Json::array();
+		auto it = docs.find(uri);
+		if (it != docs.end()) {
+			for (auto &chunk : it->second.chunks) {
+				for (auto &d : chunk.diags) {
+					int line = min(chunk.start + d.line - 1, (int)it->second.lines.size() - 1), col = d.col - 1;
+					diags.push(Json::object()
+						.set("range", Json::object().set("start", pos(line, col)).set("end", pos(line, col + d.len)))
+						.set("severity", 1)
+						.set("source", "shdl")
+						.set("message", d.msg));
+				}
+			}
+		}
+		send(Json::object().set("jsonrpc", "2.0").set("method", "textDocument/publishDiagnostics")
+			.set("params", Json::object().set("uri", uri).set("diagnostics", move(diags))));
+	}
+
+	// the chunk and context at the position of a textDocument/* request
+	const SHDLChunk *locate(const Json &params, SHDLContext &ctx) {
+		auto it = docs.find(params["textDocument"]["uri"].str);
+		if (it == docs.end() || it->second.chunks.empty())
+			return 0;
+		int line = params["position"]["line"].as_int(), col = params["position"]["character"].as_int();
+		auto &chunk = it->second.chunks[it->second.chunk_at(line)];
+		ctx = shdl_context(chunk.tokens, line - chunk.start + 1, col + 1);
+		return &chunk;
+	}
+
+	// text of the port or param entry around token k, "data[]" is lexed as three tokens
+	static string entry_name(const vector<SHDLToken> &tokens, size_t k) {
+		size_t a = k, b = k;
+		while (a && !tokens[a - 1].is_delim() && !tokens[a - 1].is_punc('{'))
+			a--;
+		while (b < tokens.size() && !tokens[b].is_delim())
+			b++;
+		string ans;
+		for (size_t i = a; i < b; i++)
+			ans += tokens[i].lexeme;
+		return ans;
+	}
+
+	Json completion(const Json &params) {
+		Json items = Json::array();
+		SHDLContext ctx;
+		if (!locate(params, ctx))
+			return items;
+		auto item = [&](const string &label, int kind, const string &detail) {
+			items.push(Json::object().set("label", label).set("kind", kind).set("detail", detail));
+		};
+		if (ctx.kind == SHDLContext::SYMBOL) {
+			for (auto &[id, tent] : table)
+				item(id, 7, tent->node->id);
+			item("next_col", 14, "keyword");
+		} else if (ctx.kind == SHDLContext::PORT || ctx.kind == SHDLContext::PARAM) {
+			auto tent = ctx.decl? symbol(ctx.decl->lexeme): 0;
+			if (tent)
+				for (auto &name : ctx.kind == SHDLContext::PORT? tent->port: tent->param)
+					item(name, ctx.kind == SHDLContext::PORT? 5: 10, tent->id);
+		}
+		return items;
+	}
+
+	Json hover(const Json &params) {
+		SHDLContext ctx;
+		auto chunk = locate(params, ctx);
+		if (!chunk || ctx.tok == chunk->tokens.size() || !ctx.decl)
+			return {};
+		auto tent = symbol(ctx.decl->lexeme);
+		if (!tent)
+			return {};
+		string text;
+		if (ctx.kind == SHDLContext::SYMBOL) {
+			text = tent->id;
+			auto join = [](const vector<string> &v) {
+				string ans;
+				for (auto &s : v)
+					ans += (ans.empty()? "": ", ") + s;
+				return ans;
+			};
+			if (tent->port.size())
+				text += "\nports: " + join(tent->port);
+			if (tent->param.size())
+				text += "\nparams: " + join(tent->param);
+		} else if (ctx.kind == SHDLContext::PORT) {
+			string name = entry_name(chunk->tokens, ctx.tok);
+			for (auto p : tent->node->list_id("port")) {
+				if (*p->inst_name() != name)
+					continue;
+				text = *p->type_name();
+				for (auto dir : {"input", "output", "bidir"})
+					if (p->first_id(dir))
+						text += " "s + dir;
+			}
+		} else if (ctx.kind == SHDLContext::PARAM) {
+			string name = entry_name(chunk->tokens, ctx.tok);
+			for (auto p : tent->node->list_id("parameter")) {
+				if (p->children[0]->str != name)
+					continue;
+				text = name;
+				if (p->children.size() > 1 && p->children[1]->str.size())
+					text += " = " + p->children[1]->str;
+				if (p->children.size() > 2 && p->children[2]->str.size())
+					text += "\n" + p->children[2]->str;
+			}
+		}
+		if (text.empty())
+			return {};
+		return Json::object().set("contents", Json::object().set("kind", "plaintext").set("value", text));
+	}
+
+	void handle(const Json &msg) {
+		const string &method = msg["method"].str;
+		const Json &params = msg["params"];
+		const Json &id = msg["id"];
+		if (method == "initialize") {
+			Json caps = Json::object()
+				.set("textDocumentSync", Json::object().set("openClose", true).set("change", 2))
+				.set("completionProvider", Json::object())
+				.set("hoverProvider", true);
+			reply(id, Json::object().set("capabilities", move(caps))
+				.set("serverInfo", Json::object().set("name", "shdl")));
+		} else if (method == "shutdown") {
+			shut = 1;
+			reply(id, {});
+		} else if (method == "textDocument/didOpen") {
+			const string &uri = params["textDocument"]["uri"].str;
+			docs.erase(uri);
+			docs.emplace(uri, SHDLDocument(&table)).first->second.set_text(params["textDocument"]["text"].str);
+			publish(uri);
+		} else if (method == "textDocument/didChange") {
+			const string &uri = params["textDocument"]["uri"].str;
+			auto it = docs.find(uri);
+			if (it == docs.end())
+				return;
+			for (auto &change : params["contentChanges"].arr) {
+				const Json &range = change["range"];
+				if (range.is_null())
+					it->second.set_text(change["text"].str);
+				else
+					it->second.edit(range["start"]["line"].as_int(), range["start"]["character"].as_int(),
+					                range["end"]["line"].as_int(), range["end"]["character"].as_int(), change["text"].str);
+			}
+			publish(uri);
+		} else if (method == "textDocument/didClose") {
+			const string &uri = params["textDocument"]["uri"].str;
+			docs.erase(uri);
+			publish(uri);
+		} else if (method == "textDocument/completion") {
+			reply(id, completion(params));
+		} else if (method == "textDocument/hover") {
+			reply(id, hover(params));
+		} else if (!id.is_null()) {
+			send(Json::object().set("jsonrpc", "2.0").set("id", id)
+				.set("error", Json::object().set("code", -32601).set("message", "method not found")));
+		}
+	}
+
+public:
+	LSPServer(const map<string, BXFTableEnt *> &table) : table(table) {}
+
+	int serve() {
+		Json msg;
+		while (read_message(msg)) {
+			if (msg["method"].str == "exit")
+				return shut? 0: 1;
+			handle(msg);
+		}
+		return shut? 0: 1;
+	}
+};
@@ -5,26 +5,79 @@
 #include <utility>
 #include <algorithm>
 #include <map>
+#include <array>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <future>
+#include <queue>
+#include <climits>
+#include <thread>
+#include <atomic>
 using namespace std;
 
 #include "common.hpp"
 #include "bxf.hpp"
+#include "builtin.hpp"
 #include "shdl.hpp"
+#include "spatial.hpp"
+#include "check.hpp"
 #include "codegen.hpp"
+#include "sheets.hpp"
+#include "json.hpp"
+#include "lsp.hpp"
 
-int main()
+map<string, BXFTableEnt *> load_bxf_table()
 {
-	auto libs = read_list("libs.txt");
+	// the compiled in symbols come from libs.txt, mylibs.txt is still read and overrides them
+	auto bxf_nodes = builtin_bxf_node_list();
+	auto libs = bxf_nodes.empty()? read_list("libs.txt"): vector<string>();
 	auto mylibs = read_list("mylibs.txt");
 	auto alllibs = libs;
 	alllibs.insert(alllibs.end(), mylibs.begin(), mylibs.end());
 
 	Reader libs_reader(alllibs);
 	auto bxf_tokens = bxf_tokenize(libs_reader);
-	auto bxf_nodes = read_bxf_node_list(bxf_tokens);
-	auto bxf_table = make_bxf_table(bxf_nodes);
+	auto lib_nodes = read_bxf_node_list(bxf_tokens);
+	bxf_nodes.insert(bxf_nodes.end(), lib_nodes.begin(), lib_nodes.end());
+	return make_bxf_table(bxf_nodes);
+}
+
+int main(int argc, char **argv)
+{
+	CodeGenOptions opt;
+	bool lsp = 0;
+	int sheet_budget = 0;
+	for (int i = 1; i < argc; i++) {
+		if (argv[i] == "-r"s) {
+			opt.route = 1;
+		} else if (argv[i] == "-n"s) {
+			opt.nudge = 1;
+		} else if (argv[i] == "-s"s && i + 1 < argc && atoi(argv[i+1]) > 0) {
+			sheet_budget = atoi(argv[++i]);
+		} else if (argv[i] == "-l"s) {
+			lsp = 1;
+		} else {
+			cerr << "usage: " << argv[0] << " [-r] [-n] [-s <n>] [-l]\n";
+			return 2;
+		}
+	}
+
+	// the design is read and parsed while the library loads, names are resolved after
+	auto bxf_table = async(launch::async, load_bxf_table);
+	if (lsp) {
+		auto table = bxf_table.get();
+		return LSPServer(table).serve();
+	}
 	Reader shdl_reader(stdin, "stdin");
 	auto shdl_tokens = shdl_tokenize(shdl_reader);
-	auto shdl_entities = shdl_read_entities(shdl_tokens, bxf_table);
-	cout << code_gen(shdl_entities);
+	SHDLNames names;
+	auto shdl_decls = shdl_parse(shdl_tokens, names);
+	auto table = bxf_table.get();
+	auto shdl_entities = shdl_resolve(shdl_decls, table, names);
+	if (sheet_budget)
+		cout << code_gen_sheets(shdl_entities, table, sheet_budget, opt);
+	else
+		cout << code_gen(shdl_entities, opt);
 }
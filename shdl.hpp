@@ -1,13 +1,49 @@
 struct SHDLToken {
 	enum Type { KW, ID, PUNC, STR, NUM, NL };
+	enum Keyword { NONE, PORT, PARAM, NEXT_COL, INPUT, OUTPUT, BIDIR };
 	Type type;
+	Keyword kw = NONE;
 	string lexeme;
 
 	string file;
 	int line, col;
+
+	bool is_punc(char c) const { return type == PUNC && lexeme[0] == c; }
+	bool is_delim() const { return type == NL || is_punc(';') || is_punc(':') || is_punc('}'); }
+	bool is_pin() const { return kw == INPUT || kw == OUTPUT || kw == BIDIR; }
+};
+
+struct SHDLDiag {
+	string file;
+	int line, col;
+	string msg;
+	int len;
+};
+
+// thrown after an error was recorded, to pick up parsing at the next declaration
+struct SHDLRecover {};
+
+// without a diagnostics list errors are printed and end the run, otherwise they are recorded
+void shdl_error(vector<SHDLDiag> *diags, const string &file, int line, int col, const string &msg, int len = 1)
+{
+	if (!diags) {
+		cerr << file << ":" << line << "-" << col << " " << msg << '\n';
+		exit(1);
+	}
+	diags->push_back({file, line, col, msg, len});
+}
+
+void shdl_error(vector<SHDLDiag> *diags, const SHDLToken &tok, const string &msg)
+{
+	shdl_error(diags, tok.file, tok.line, tok.col, msg, max((int)tok.lexeme.size(), 1));
+}
+
+const pair<const char *, SHDLToken::Keyword> shdl_keywords[] = {
+	{"port", SHDLToken::PORT}, {"param", SHDLToken::PARAM}, {"next_col", SHDLToken::NEXT_COL},
+	{"input", SHDLToken::INPUT}, {"output", SHDLToken::OUTPUT}, {"bidir", SHDLToken::BIDIR},
 };
 
-vector<SHDLToken> shdl_tokenize(Reader &reader)
+vector<SHDLToken> shdl_tokenize(Reader &reader, vector<SHDLDiag> *diags = 0)
 {
 	vector<SHDLToken> ans;
 	int c;
@@ -15,16 +51,14 @@ vector<SHDLToken> shdl_tokenize(Reader &reader)
 	auto is_letter = [](int c) { return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_'; };
 	auto is_punc = [](int c) { return is_in(c, "[]{}()<>,.:;-+/*^"s); };
 	auto unexpected = [&](int c) {
+		string msg;
 		if (c == -1)
-			cerr << "unexpected eof\n";
-		else {
-			cerr << reader.file() << ":" << reader.line() << "-" << reader.col() << '\n';
-			if (0 < c && c < 128)
-				cerr << "unexpected char " << (char)c << '\n';
-			else
-				cerr << "unexpected char " << c << '\n';
-		}
-		exit(1);
+			msg = "unexpected eof";
+		else if (0 < c && c < 128)
+			msg = "unexpected char "s + (char)c;
+		else
+			msg = "unexpected char " + to_string(c);
+		shdl_error(diags, reader.file(), reader.line(), reader.col(), msg);
 	};
 	while ((c = reader.peek()) != -1) {
 		SHDLToken token;
@@ -45,10 +79,11 @@ vector<SHDLToken> shdl_tokenize(Reader &reader)
 		} else if (is_letter(c)) {
 			while (is_letter(reader.peek()) || is_num(reader.peek()))
 				l += (char)reader.read();
-			if (is_in(l, vector<string>{"port", "param", "next_col", "input", "output", "bidir"}))
-				push(SHDLToken::KW, l);
-			else
-				push(SHDLToken::ID, l);
+			token.kw = SHDLToken::NONE;
+			for (auto &[name, kw] : shdl_keywords)
+				if (l == name)
+					token.kw = kw;
+			push(token.kw? SHDLToken::KW: SHDLToken::ID, l);
 		} else if (c == '"') {
 			reader.read();
 			while (reader.peek() != '"' && reader.peek() != -1) {
@@ -56,8 +91,10 @@ vector<SHDLToken> shdl_tokenize(Reader &reader)
 				if (l.back() == '\\')
 					l += (char)reader.read();
 			}
-			if (reader.peek() != '"')
+			if (reader.peek() != '"') {
 				unexpected(reader.peek());
+				break;
+			}
 			reader.read();
 			push(SHDLToken::STR, l);
 		} else if (c == '/') {
@@ -67,8 +104,10 @@ vector<SHDLToken> shdl_tokenize(Reader &reader)
 				int state = 0;
 				while (state != 2) {
 					int x = reader.read();
-					if (x == -1)
+					if (x == -1) {
 						unexpected(x);
+						break;
+					}
 					if (x == '*')
 						state = 1;
 					if (state == 1 && x == '/')
@@ -90,47 +129,99 @@ vector<SHDLToken> shdl_tokenize(Reader &reader)
 			reader.read();
 		} else {
 			unexpected(c);
+			reader.read();
 		}
 	}
+	// the parser expects every line to end in NL, which only an error could leave out
+	if (ans.size() && ans.back().type != SHDLToken::NL)
+		ans.push_back({SHDLToken::NL, SHDLToken::NONE, "\n", reader.file(), reader.line(), reader.col()});
 	return ans;
 }
 
+// the first token of a line that begins a new declaration, whatever its indentation.
+// only meaningful outside braces, callers keep track of those
+bool shdl_decl_start(const vector<SHDLToken> &tokens, size_t k)
+{
+	const SHDLToken &tok = tokens[k];
+	return k && tokens[k - 1].type == SHDLToken::NL
+	       && (tok.type == SHDLToken::ID || (tok.type == SHDLToken::KW && tok.kw != SHDLToken::PORT && tok.kw != SHDLToken::PARAM));
+}
+
+// names and bindings of one design are stored once, declarations and entities refer to
+// them by view so the pool has to outlive them
+class SHDLNames {
+private:
+	unordered_set<string> pool;
+
+public:
+	SHDLNames() {}
+	SHDLNames(const SHDLNames &) = delete;
+	SHDLNames(SHDLNames &&) = default;
+	SHDLNames &operator=(SHDLNames &&) = default;
+
+	string_view intern(const string &s) { return *pool.insert(s).first; }
+};
+
+// splits "name[a..b]" into name, a and b, a list of names is not a range
+bool bus_range(string_view s, string_view &name, int &a, int &b)
+{
+	size_t open = s.rfind('['), dots = s.find("..", open);
+	if (open == string_view::npos || dots == string_view::npos || s.back() != ']' || s.find(',') != string_view::npos)
+		return 0;
+	auto num = [](string_view d, int &v) {
+		if (d.empty() || d.size() > 9 || !all_of(d.begin(), d.end(), [](char c) { return '0' <= c && c <= '9'; }))
+			return 0;
+		v = stoi(string(d));
+		return 1;
+	};
+	name = s.substr(0, open);
+	return num(s.substr(open + 1, dots - open - 1), a) && num(s.substr(dots + 2, s.size() - dots - 3), b);
+}
+
+// "l: r" or just "l" inside a port or param brace
+struct SHDLBinding {
+	string_view l, r;
+	const SHDLToken *tok;
+};
+
+// one declaration of the design as written, before symbol names are looked up
+struct SHDLDecl {
+	const SHDLToken *type; // symbol name or pin direction, 0 for next_col
+	string_view name;
+	int cnt;
+	vector<SHDLBinding> port;
+	vector<SHDLBinding> param;
+};
+
 struct SHDLEntity {
-	string id;
+	string_view id;
 	const BXFTableEnt *tent;
-	vector<string> port;
-	vector<string> param;
+	vector<string_view> port;
+	vector<string_view> param;
 };
 
-vector<SHDLEntity> shdl_read_entities(const vector<SHDLToken> &tokens, const map<string, BXFTableEnt *> table)
+int constexpr shdl_max_array = 65536;
+
+vector<SHDLDecl> shdl_parse(const vector<SHDLToken> &tokens, SHDLNames &names, vector<SHDLDiag> *diags = 0)
 {
-	vector<SHDLEntity> ans;
+	vector<SHDLDecl> ans;
 	size_t ptr = 0;
 
-	auto unexpected = [](const SHDLToken &tok) {
-		cerr << tok.file << ":" << tok.line << "-" << tok.col << " ";
-		cerr << "unexpected token " << tok.lexeme << '\n';
-		exit(1);
-	};
-	auto unexpected_eof = []() {
-		cerr << "unexpected eof\n";
-		exit(1);
+	auto fail = [&](const SHDLToken &tok, const string &msg) {
+		shdl_error(diags, tok, msg);
+		throw SHDLRecover();
 	};
-	auto undefined = [](string id) {
-		cerr << id << " is undefined\n";
-		exit(1);
+	auto unexpected = [&](const SHDLToken &tok) {
+		fail(tok, "unexpected token " + tok.lexeme);
 	};
-	auto bad_port_param = [](string s) {
-		cerr << "bad port or parameter " << s << '\n';
-		exit(1);
+	auto unexpected_eof = [&]() {
+		fail(tokens.back(), "unexpected eof");
 	};
-	auto bad_port_param_unnamed = []() {
-		cerr << "unnamed port or param past the end\n";
-		exit(1);
+	auto array_size = [&](const SHDLToken &tok) {
+		fail(tok, "array size must be 1 to " + to_string(shdl_max_array));
 	};
-	auto port_param_before_entity = []() {
-		cerr << "port or param used before entity\n";
-		exit(1);
+	auto port_param_before_entity = [&](const SHDLToken &tok) {
+		fail(tok, "port or param used before entity");
 	};
 	auto skip_nl = [&]() {
 		while (ptr != tokens.size() && tokens[ptr].type == SHDLToken::NL)
@@ -138,120 +229,211 @@ vector<SHDLEntity> shdl_read_entities(const vector<SHDLToken> &tokens, const map
 		if (ptr == tokens.size())
 			unexpected_eof();
 	};
+	string buf;
 	auto read_till_delim = [&]() {
 		skip_nl();
-		string ans;
-		while (!(tokens[ptr].type == SHDLToken::NL
-		         || (tokens[ptr].type == SHDLToken::PUNC && is_in(tokens[ptr].lexeme, vector<string>{";", ":", "}"}))))
-			ans += tokens[ptr++].lexeme;
-		if (ans.empty())
+		buf.clear();
+		while (!tokens[ptr].is_delim())
+			buf += tokens[ptr++].lexeme;
+		if (buf.empty())
 			unexpected(tokens[ptr]);
-		return ans;
+		return names.intern(buf);
 	};
-	auto read_brace = [&]() {
+	bool in_brace = 0;
+	auto read_brace = [&](vector<SHDLBinding> &pairs) {
 		skip_nl();
-		if (tokens[ptr].type != SHDLToken::PUNC || tokens[ptr].lexeme != "{")
+		if (!tokens[ptr].is_punc('{'))
 			unexpected(tokens[ptr]);
 		ptr++;
-		vector<pair<string, string>> ans;
-		pair<string, string> one;
+		in_brace = 1;
+		SHDLBinding one = {};
 		int state = 0;
 		skip_nl();
-		while (tokens[ptr].type != SHDLToken::PUNC || tokens[ptr].lexeme != "}") {
-			string s = read_till_delim();
+		while (!tokens[ptr].is_punc('}')) {
+			const SHDLToken *tok = &tokens[ptr];
+			string_view s = read_till_delim();
 			if (state == 0) {
-				one.first = s;
+				one.l = s;
+				one.tok = tok;
 				state = 1;
 			} else if (state == 1) {
-				one.second = s;
+				one.r = s;
 				state = 2;
 			}
-			if (tokens[ptr].type != SHDLToken::PUNC || tokens[ptr].lexeme != ":") {
-				ans.push_back(one);
+			if (!tokens[ptr].is_punc(':')) {
+				pairs.push_back(one);
 				one = {};
 				state = 0;
 			}
 			if (state == 2)
 				unexpected(tokens[ptr]);
-			if (tokens[ptr].type != SHDLToken::PUNC || tokens[ptr].lexeme != "}")
+			if (!tokens[ptr].is_punc('}'))
 				ptr++;
 			skip_nl();
 		}
 		ptr++;
-		return ans;
+		in_brace = 0;
 	};
-	SHDLEntity selected_ent;
-	ssize_t port_last, param_last;
-	map<string, int> type_cnt;
-	while (ptr != tokens.size()) {
-		SHDLToken tok = tokens[ptr++];
+	ssize_t selected = -1;
+	while (ptr != tokens.size()) try {
+		const SHDLToken &tok = tokens[ptr++];
 		if (tok.type == SHDLToken::NL) {
 			// nothing
-		} else if (tok.type == SHDLToken::KW && is_in(tok.lexeme, vector<string>{"input", "output", "bidir"})) {
-			string name = read_till_delim();
-			auto it_tent = table.find(tok.lexeme);
-			if (it_tent == table.end())
-				undefined(tok.lexeme);
-			auto tent = it_tent->second;
-			ans.push_back({name, tent, {}, {}});
+		} else if (tok.is_pin()) {
+			// pins go before the symbol still taking port and param, which stays selected
+			SHDLDecl pin = {&tok, read_till_delim(), 1, {}, {}};
+			if (selected == -1) {
+				ans.push_back(pin);
+			} else {
+				ans.insert(ans.begin() + selected, pin);
+				selected++;
+			}
 		} else if (tok.type == SHDLToken::ID) {
-			if (selected_ent.id.size())
-				ans.push_back(selected_ent);
-			auto it_tent = table.find(tok.lexeme);
-			if (it_tent == table.end())
-				undefined(tok.lexeme);
-			selected_ent.tent = it_tent->second;
-			if (tokens[ptr].type != SHDLToken::ID)
-				selected_ent.id = selected_ent.tent->id + "_" + to_string(type_cnt[selected_ent.tent->id]++);
-			else
-				selected_ent.id = tokens[ptr++].lexeme;
-			selected_ent.port.assign(selected_ent.tent->port.size(), "");
-			selected_ent.param.assign(selected_ent.tent->param.size(), "");
-			param_last = port_last = -1;
-		} else if (tok.type == SHDLToken::KW && tok.lexeme == "port") {
-			if (selected_ent.id.empty())
-				port_param_before_entity();
-			auto pairs = read_brace();
-			for (auto [l, r] : pairs) {
-				if (r.size()) {
-					port_last = selected_ent.tent->port_search(l);
-					if (port_last == selected_ent.port.size())
-						bad_port_param(l);
-					selected_ent.port[port_last] = r;
-				} else {
-					++port_last;
-					if (port_last == selected_ent.port.size())
-						bad_port_param_unnamed();
-					selected_ent.port[port_last] = l;
-				}
+			int cnt = 1;
+			if (tokens[ptr].is_punc('[')) {
+				ptr++;
+				if (tokens[ptr].type != SHDLToken::NUM)
+					unexpected(tokens[ptr]);
+				const string &n = tokens[ptr].lexeme;
+				cnt = n.size() <= 9? stoi(n): 0;
+				if (cnt < 1 || cnt > shdl_max_array)
+					array_size(tokens[ptr]);
+				ptr++;
+				if (!tokens[ptr].is_punc(']'))
+					unexpected(tokens[ptr]);
+				ptr++;
+			}
+			string_view name;
+			if (tokens[ptr].type == SHDLToken::ID)
+				name = names.intern(tokens[ptr++].lexeme);
+			selected = ans.size();
+			ans.push_back({&tok, name, cnt, {}, {}});
+		} else if (tok.kw == SHDLToken::PORT) {
+			if (selected == -1)
+				port_param_before_entity(tok);
+			read_brace(ans[selected].port);
+		} else if (tok.kw == SHDLToken::PARAM) {
+			if (selected == -1)
+				port_param_before_entity(tok);
+			read_brace(ans[selected].param);
+		} else if (tok.kw == SHDLToken::NEXT_COL) {
+			selected = -1;
+			ans.push_back({0, {}, 0, {}, {}});
+		} else {
+			unexpected(tok);
+		}
+	} catch (SHDLRecover) {
+		// skip to the next line starting with a declaration outside a brace, braces don't nest
+		selected = -1;
+		while (ptr != tokens.size() && (in_brace || !shdl_decl_start(tokens, ptr))) {
+			if (tokens[ptr].is_punc('{'))
+				in_brace = 1;
+			else if (tokens[ptr].is_punc('}'))
+				in_brace = 0;
+			ptr++;
+		}
+	}
+	return ans;
+}
+
+vector<SHDLEntity> shdl_resolve(const vector<SHDLDecl> &decls, const map<string, BXFTableEnt *> &table,
+                                SHDLNames &names, vector<SHDLDiag> *diags = 0)
+{
+	vector<SHDLEntity> ans;
+
+	auto undefined = [&](const SHDLToken &tok) {
+		shdl_error(diags, tok, tok.lexeme + " is undefined");
+	};
+	auto bad_port_param = [&](const SHDLBinding &b) {
+		shdl_error(diags, *b.tok, "bad port or parameter " + string(b.l));
+	};
+	auto bad_port_param_unnamed = [&](const SHDLBinding &b) {
+		shdl_error(diags, *b.tok, "unnamed port or param past the end");
+	};
+	string buf;
+	size_t first;
+	int cnt;
+	// net of instance i of the array, each name of a list on its own. a range as wide as the
+	// array is split bit by bit starting from its low end, anything else goes to every instance
+	auto array_net = [&](string_view net, int i) {
+		if (cnt == 1)
+			return net;
+		buf.clear();
+		bool split = 0;
+		for (size_t p = 0; p <= net.size(); ) {
+			size_t q = min(net.find(',', p), net.size());
+			string_view one = net.substr(p, q - p), bus;
+			int a, b;
+			if (p)
+				buf += ',';
+			if (bus_range(one, bus, a, b) && abs(a - b) + 1 == cnt) {
+				buf += bus;
+				buf += '[';
+				buf += to_string(min(a, b) + i);
+				buf += ']';
+				split = 1;
+			} else {
+				buf += one;
 			}
-		} else if (tok.type == SHDLToken::KW && tok.lexeme == "param") {
-			if (selected_ent.id.empty())
-				port_param_before_entity();
-			auto pairs = read_brace();
-			for (auto [l, r] : pairs) {
-				if (r.size()) {
-					param_last = selected_ent.tent->param_search(l);
-					if (param_last == selected_ent.param.size())
-						bad_port_param(l);
-					selected_ent.param[param_last] = r;
-				} else {
-					++param_last;
-					if (param_last == selected_ent.param.size())
-						bad_port_param_unnamed();
-					selected_ent.param[param_last] = l;
+			p = q + 1;
+		}
+		return split? names.intern(buf): net;
+	};
+	// binds pairs to names (ports or params) of the instances of the array,
+	// unnamed entries continue after the last bound one
+	auto bind = [&](const vector<SHDLBinding> &pairs, vector<string_view> SHDLEntity::*slots, const vector<string> &names) {
+		ssize_t last = -1;
+		for (auto &b : pairs) {
+			string_view r = b.r;
+			if (r.size()) {
+				last = find(names.begin(), names.end(), b.l) - names.begin();
+				if (last == (ssize_t)names.size()) {
+					bad_port_param(b);
+					continue;
+				}
+			} else {
+				++last;
+				if (last >= (ssize_t)names.size()) {
+					bad_port_param_unnamed(b);
+					continue;
 				}
+				r = b.l;
 			}
-		} else if (tok.type == SHDLToken::KW && tok.lexeme == "next_col") {
-			if (selected_ent.id.size())
-				ans.push_back(selected_ent);
-			selected_ent.id = "";
+			for (int i = 0; i < cnt; i++)
+				(ans[first + i].*slots)[last] = array_net(r, i);
+		}
+	};
+	unordered_map<const BXFTableEnt *, int> type_cnt;
+	for (auto &decl : decls) {
+		if (!decl.type) {
 			ans.push_back({"-next_col"});
-		} else {
-			unexpected(tok);
+			continue;
+		}
+		auto it_tent = table.find(decl.type->lexeme);
+		if (it_tent == table.end()) {
+			undefined(*decl.type);
+			continue;
+		}
+		auto tent = it_tent->second;
+		if (decl.type->type == SHDLToken::KW) {
+			ans.push_back({decl.name, tent, {}, {}});
+			continue;
+		}
+		int &auto_cnt = type_cnt[tent];
+		first = ans.size();
+		cnt = decl.cnt;
+		for (int i = 0; i < cnt; i++) {
+			if (decl.name.size() && cnt == 1) {
+				buf = decl.name;
+			} else {
+				buf = decl.name.size()? decl.name: tent->id;
+				buf += '_';
+				buf += to_string(decl.name.size()? i: auto_cnt++);
+			}
+			ans.push_back({names.intern(buf), tent, vector<string_view>(tent->port.size()), vector<string_view>(tent->param.size())});
 		}
+		bind(decl.port, &SHDLEntity::port, tent->port);
+		bind(decl.param, &SHDLEntity::param, tent->param);
 	}
-	if (selected_ent.id.size())
-		ans.push_back(selected_ent);
 	return ans;
 }
@@ -0,0 +1,268 @@
+// splitting a design over several sheets. every sheet becomes a block of its own with a
+// pin for each net it shares with another sheet or with a pin of the design, the top level
+// sheet holds the design's pins and one instance of every block, joined by named stubs.
+
+// how a sheet uses a bit of a net, the strongest use decides the direction of its pin
+enum SheetUse { SHEET_IN, SHEET_BIDIR, SHEET_OUT };
+const char *const sheet_use_dir[] = {"input", "bidir", "output"};
+
+// name of bits [lo, hi] of a net, lo is -1 for a plain net
+string sheet_net_name(const string &base, int lo, int hi)
+{
+	if (lo < 0)
+		return base;
+	if (lo == hi)
+		return base + "[" + to_string(lo) + "]";
+	return base + "[" + to_string(hi) + ".." + to_string(lo) + "]";
+}
+
+// bits [lo, hi] of a net used by a sheet, lo and hi are -1 for a plain net
+struct SheetBits {
+	int lo, hi, sheet, use;
+};
+
+// splits the uses of a net into the runs of bits each sheet has to share, a run that
+// crosses sheets or reaches a pin of the design. the sweep goes over the ends of the
+// uses, never over single bits, so wide buses cost no more than narrow ones
+void shared_runs(const string &base, vector<SheetBits> uses, bool pin,
+                 vector<vector<pair<string, SheetBits>>> &runs)
+{
+	vector<int> cuts;
+	for (auto &u : uses) {
+		cuts.push_back(u.lo);
+		cuts.push_back(u.hi + 1);
+	}
+	sort(cuts.begin(), cuts.end());
+	cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+	sort(uses.begin(), uses.end(), [](const SheetBits &a, const SheetBits &b) { return a.lo < b.lo; });
+
+	map<int, array<int, 3>> active; // uses of each sheet covering the current bits
+	priority_queue<pair<int, size_t>, vector<pair<int, size_t>>, greater<pair<int, size_t>>> ends;
+	size_t next = 0;
+	for (size_t i = 0; i + 1 < cuts.size(); i++) {
+		int lo = cuts[i], hi = cuts[i+1] - 1;
+		while (!ends.empty() && ends.top().first < lo) {
+			auto &u = uses[ends.top().second];
+			if (!--active[u.sheet][u.use] && active[u.sheet] == array<int, 3>{})
+				active.erase(u.sheet);
+			ends.pop();
+		}
+		for (; next < uses.size() && uses[next].lo == lo; next++) {
+			active[uses[next].sheet][uses[next].use]++;
+			ends.push({uses[next].hi, next});
+		}
+		if (!pin && active.size() < 2)
+			continue;
+		for (auto &[k, cnt] : active) {
+			int use = cnt[SHEET_OUT]? SHEET_OUT: cnt[SHEET_BIDIR]? SHEET_BIDIR: SHEET_IN;
+			auto &r = runs[k];
+			SheetBits *last = r.size() && r.back().first == base? &r.back().second: 0;
+			if (last && last->lo >= 0 && last->hi + 1 == lo && last->use == use)
+				last->hi = hi;
+			else
+				r.push_back({base, {lo, hi, k, use}});
+		}
+	}
+}
+
+// calls f(base, lo, hi) for every name in a net list like "a, b[3], c[7..0]",
+// lo and hi are -1 for a plain net
+template<class F>
+void for_each_net(string_view s, F f)
+{
+	while (s.size()) {
+		size_t comma = s.find(',');
+		string_view net = s.substr(0, comma);
+		s = comma == string_view::npos? "": s.substr(comma + 1);
+		while (net.size() && isspace((unsigned char)net.front()))
+			net.remove_prefix(1);
+		while (net.size() && isspace((unsigned char)net.back()))
+			net.remove_suffix(1);
+		if (net.empty())
+			continue;
+		string_view base;
+		int a, b;
+		if (bus_range(net, base, a, b)) {
+			f(string(base), min(a, b), max(a, b));
+			continue;
+		}
+		size_t open = net.rfind('[');
+		if (open != string_view::npos && net.back() == ']') {
+			string_view d = net.substr(open + 1, net.size() - open - 2);
+			if (d.size() && d.size() <= 9 && all_of(d.begin(), d.end(), [](char c) { return '0' <= c && c <= '9'; })) {
+				f(string(net.substr(0, open)), stoi(string(d)), stoi(string(d)));
+				continue;
+			}
+		}
+		f(string(net), -1, -1);
+	}
+}
+
+// cuts the instances into sheets of at most budget each, a column only gets split
+// when it doesn't fit on an empty sheet. pins are left out, they go to the top level
+vector<vector<SHDLEntity>> split_sheets(const vector<SHDLEntity> &vec, int budget)
+{
+	vector<vector<SHDLEntity>> cols(1);
+	for (auto &ent : vec) {
+		if (ent.id == "-next_col")
+			cols.emplace_back();
+		else if (ent.tent->node->id != "pin")
+			cols.back().push_back(ent);
+	}
+
+	vector<vector<SHDLEntity>> ans;
+	vector<SHDLEntity> cur;
+	int cnt = 0;
+	auto flush = [&]() {
+		if (cnt)
+			ans.push_back(move(cur));
+		cur.clear();
+		cnt = 0;
+	};
+	for (auto &col : cols) {
+		if (col.empty())
+			continue;
+		if (cnt && cnt + (int)col.size() > budget)
+			flush();
+		if (cnt)
+			cur.push_back({"-next_col"});
+		for (auto &ent : col) {
+			if (cnt == budget)
+				flush();
+			cur.push_back(ent);
+			cnt++;
+		}
+	}
+	flush();
+	return ans;
+}
+
+// block symbol of a sheet, inputs on the left and everything else on the right
+string sheet_symbol(const string &name, const vector<pair<string, string>> &ports)
+{
+	int left = 0, right = 0;
+	size_t longest = name.size();
+	for (auto &[net, dir] : ports) {
+		(dir == "input"? left: right)++;
+		longest = max(longest, net.size());
+	}
+	int w = max(128, (int)longest * 12 + 48);
+	w += (8 - w % 8) % 8;
+	int h = 48 + 16 * max(1, max(left, right));
+	auto rect = [](int x1, int y1, int x2, int y2) {
+		return "(rect " + to_string(x1) + " " + to_string(y1) + " " + to_string(x2) + " " + to_string(y2) + ")";
+	};
+
+	string ans = "(header \"symbol\" (version \"1.1\"))\n(symbol\n";
+	ans += "\t" + rect(0, 0, w, h) + "\n";
+	ans += "\t(text \"" + name + "\" " + rect(5, 0, w - 5, 16) + "(font \"Arial\" (font_size 10)))\n";
+	ans += "\t(text \"inst\" " + rect(8, h - 16, 25, h - 4) + "(font \"Arial\" ))\n";
+	int yl = 32, yr = 32;
+	for (auto &[net, dir] : ports) {
+		bool in = dir == "input";
+		int x = in? 0: w, y = in? yl: yr;
+		int tw = net.size() * 6;
+		int tx = in? 21: w - 21 - tw;
+		(in? yl: yr) += 16;
+		ans += "\t(port\n\t\t(pt " + to_string(x) + " " + to_string(y) + ")\n\t\t(" + dir + ")\n";
+		ans += "\t\t(text \"" + net + "\" " + rect(0, 0, tw, 12) + "(font \"Arial\" ))\n";
+		ans += "\t\t(text \"" + net + "\" " + rect(tx, y - 5, tx + tw, y + 7) + "(font \"Arial\" ))\n";
+		ans += "\t\t(line (pt " + to_string(x) + " " + to_string(y) + ")(pt " + to_string(in? 16: w - 16) + " " + to_string(y)
+			+ ")(line_width " + (is_bus_name(net)? "3": "1") + "))\n\t)\n";
+	}
+	ans += "\t(drawing\n\t\t(rectangle " + rect(16, 16, w - 16, h - 16) + "(line_width 1))\n\t)\n)\n";
+	return ans;
+}
+
+void write_file(const string &path, const string &s)
+{
+	ofstream out(path);
+	if (!out.is_open()) {
+		cerr << "can't open " << path << '\n';
+		exit(1);
+	}
+	out << s;
+}
+
+// writes sheet_k.bdf and sheet_k.bsf for every sheet and returns the top level sheet
+string code_gen_sheets(const vector<SHDLEntity> &vec, const map<string, BXFTableEnt *> &table,
+                       int budget, const CodeGenOptions &opt)
+{
+	auto pin_tent = [&](const string &dir) {
+		auto it = table.find(dir);
+		if (it == table.end()) {
+			cerr << dir << " pin is undefined\n";
+			exit(1);
+		}
+		return it->second;
+	};
+
+	auto sheets = split_sheets(vec, budget);
+	set<string> pin_nets;
+	for (auto &ent : vec)
+		if (ent.id != "-next_col" && ent.tent->node->id == "pin")
+			for_each_net(ent.id, [&](const string &base, int, int) { pin_nets.insert(base); });
+	map<string, vector<SheetBits>> uses;
+	for (size_t k = 0; k < sheets.size(); k++) {
+		for (auto &ent : sheets[k]) {
+			if (ent.id == "-next_col")
+				continue;
+			for (auto port : ent.tent->node->list_id("port")) {
+				auto net = ent.port[ent.tent->port_search(*port->inst_name())];
+				int use = port->first_id("output")? SHEET_OUT: port->first_id("bidir")? SHEET_BIDIR: SHEET_IN;
+				for_each_net(net, [&](const string &base, int lo, int hi) { uses[base].push_back({lo, hi, (int)k, use}); });
+			}
+		}
+	}
+	vector<vector<pair<string, SheetBits>>> runs(sheets.size());
+	for (auto &[base, v] : uses)
+		shared_runs(base, v, pin_nets.count(base), runs);
+
+	// the blocks and their pins are made up front, the library isn't safe to grow concurrently
+	SHDLNames names;
+	vector<string> symbol_text(sheets.size());
+	vector<SHDLEntity> top;
+	for (auto &ent : vec)
+		if (ent.id != "-next_col" && ent.tent->node->id == "pin")
+			top.push_back(ent);
+	top.push_back({"-next_col"});
+	for (size_t k = 0; k < sheets.size(); k++) {
+		string sheet = "sheet_" + to_string(k + 1);
+		// one pin per run of consecutive shared bits used the same way, so a sheet only
+		// drives the bits it has a driver for
+		vector<pair<string, string>> ports;
+		vector<SHDLEntity> pins;
+		for (auto &[base, r] : runs[k]) {
+			string net = sheet_net_name(base, r.lo, r.hi);
+			ports.push_back({net, sheet_use_dir[r.use]});
+			pins.push_back({names.intern(net), pin_tent(sheet_use_dir[r.use]), {}, {}});
+		}
+		pins.push_back({"-next_col"});
+		sheets[k].insert(sheets[k].begin(), pins.begin(), pins.end());
+		symbol_text[k] = sheet_symbol(sheet, ports);
+		Reader reader(symbol_text[k], sheet + ".bsf");
+		auto node = read_bxf_node_list(bxf_tokenize(reader))[1];
+		auto tent = new BXFTableEnt(node);
+		SHDLEntity inst = {names.intern(sheet + "_inst"), tent, {}, {}};
+		for (auto &p : ports)
+			inst.port.push_back(names.intern(p.first));
+		top.push_back(inst);
+	}
+
+	vector<string> docs(sheets.size());
+	atomic<size_t> next(0);
+	vector<thread> workers(min<size_t>(sheets.size(), max(1u, thread::hardware_concurrency())));
+	for (auto &w : workers)
+		w = thread([&]() {
+			for (size_t k; (k = next++) < sheets.size(); )
+				docs[k] = code_gen(sheets[k], opt);
+		});
+	for (auto &w : workers)
+		w.join();
+	for (size_t k = 0; k < sheets.size(); k++) {
+		string sheet = "sheet_" + to_string(k + 1);
+		write_file(sheet + ".bdf", docs[k]);
+		write_file(sheet + ".bsf", symbol_text[k]);
+	}
+	return code_gen(top, opt);
+}
@@ -0,0 +1,82 @@
+struct Box {
+	int x1, y1, x2, y2;
+
+	bool touches(const Box &b) const {
+		return x1 <= b.x2 && b.x1 <= x2 && y1 <= b.y2 && b.y1 <= y2;
+	}
+	bool overlaps(const Box &b) const {
+		return x1 < b.x2 && b.x1 < x2 && y1 < b.y2 && b.y1 < y2;
+	}
+};
+
+// a wire may run along a symbol's outline but never through its body
+bool crosses_body(const Box &s, const Box &b)
+{
+	bool ox = s.x1 == s.x2? b.x1 < s.x1 && s.x1 < b.x2: s.x1 < b.x2 && b.x1 < s.x2;
+	bool oy = s.y1 == s.y2? b.y1 < s.y1 && s.y1 < b.y2: s.y1 < b.y2 && b.y1 < s.y2;
+	return ox && oy;
+}
+
+// wires of different nets may only cross at right angles away from both ends,
+// anything else would be joined by quartus
+bool shorts_wire(const Box &s, const Box &w)
+{
+	bool sp = s.x1 == s.x2 && s.y1 == s.y2, wp = w.x1 == w.x2 && w.y1 == w.y2;
+	if (sp || wp)
+		return 1;
+	bool sh = s.y1 == s.y2, wh = w.y1 == w.y2;
+	if (sh == wh)
+		return 1;
+	const Box &h = sh? s: w, &v = sh? w: s;
+	return v.x1 == h.x1 || v.x1 == h.x2 || h.y1 == v.y1 || h.y1 == v.y2;
+}
+
+// uniform grid over boxes, each box is registered in every cell it touches
+class GridIndex {
+private:
+	int cell;
+	vector<Box> boxes;
+	vector<int> tags;
+	unordered_map<long long, vector<int>> cells;
+	mutable vector<int> seen;
+	mutable int stamp;
+
+	static long long key(int cx, int cy) { return (long long)cx << 32 ^ (unsigned)cy; }
+	int cell_of(int v) const { return v >= 0? v / cell: (v - cell + 1) / cell; }
+
+public:
+	GridIndex(int cell = 128) : cell(cell), stamp(0) {}
+
+	int insert(const Box &b, int tag) {
+		int id = boxes.size();
+		boxes.push_back(b);
+		tags.push_back(tag);
+		seen.push_back(0);
+		for (int cx = cell_of(b.x1); cx <= cell_of(b.x2); cx++)
+			for (int cy = cell_of(b.y1); cy <= cell_of(b.y2); cy++)
+				cells[key(cx, cy)].push_back(id);
+		return id;
+	}
+
+	// calls f(box, tag) once for every stored box touching b
+	template<class F>
+	void query(const Box &b, F f) const {
+		stamp++;
+		for (int cx = cell_of(b.x1); cx <= cell_of(b.x2); cx++) {
+			for (int cy = cell_of(b.y1); cy <= cell_of(b.y2); cy++) {
+				auto it = cells.find(key(cx, cy));
+				if (it == cells.end())
+					continue;
+				for (int id : it->second) {
+					if (seen[id] == stamp)
+						continue;
+					seen[id] = stamp;
+					if (boxes[id].touches(b))
+						f(boxes[id], tags[id]);
+				}
+			}
+		}
+	}
+
+	size_t size() const { return boxes.size(); }
+};